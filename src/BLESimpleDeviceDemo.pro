@@ -11,12 +11,16 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    blepollscheduler.cpp \
     blesimpledevice.cpp \
+    blesimpledevicetransport.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
+    blepollscheduler.h \
     blesimpledevice.h \
+    blesimpledevicetransport.h \
     mainwindow.h
 
 FORMS += \
@@ -0,0 +1,46 @@
+QT       += core bluetooth
+QT       -= gui
+
+TEMPLATE = lib
+TARGET = BLESimpleDevice
+
+CONFIG += c++11 shared hide_symbols
+
+DEFINES += BLESIMPLEDEVICE_LIBRARY
+
+SOURCES += \
+    blepollscheduler.cpp \
+    blesimpledevice.cpp \
+    blesimpledevicetransport.cpp \
+    blesimpledeviceapi.cpp
+
+HEADERS += \
+    blepollscheduler.h \
+    blesimpledevice.h \
+    blesimpledevicetransport.h \
+    blesimpledeviceapi.h \
+    blesimpledeviceapi_p.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/lib
+else: unix:!android: target.path = /opt/$${TARGET}/lib
+!isEmpty(target.path): INSTALLS += target
+
+win32: {
+    #Сборка файлов релизной версии
+
+    CONFIG(debug, debug|release) {
+        #debug
+    } else {
+        #release
+        contains(QT_ARCH, i386) {
+            #Для Windows x32
+            DESTDIR = $$_PRO_FILE_PWD_/../release_lib_win32
+        } else {
+            #Для Windows x64
+            DESTDIR = $$_PRO_FILE_PWD_/../release_lib_win64
+        }
+
+        QMAKE_POST_LINK += $$(QTDIR)/bin/windeployqt --release $$DESTDIR/$${TARGET}.dll $$escape_expand(\\n\\t)
+    }
+}
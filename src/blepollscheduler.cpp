@@ -0,0 +1,291 @@
+#include "blepollscheduler.h"
+#include <QDebug>
+
+namespace
+{
+
+const static double PollingLinkShare = 0.5; // rest of the link is left for notifications
+const static double MinColdShare = 0.1; // cold channels are slowed down, never stopped
+const static double RoundTripSmoothing = 0.125;
+const static int MaxBackoffShift = 16;
+
+}
+
+const int BLEPollScheduler::MaxPendingReads;
+const int BLEPollScheduler::ReadTimeout;
+const int BLEPollScheduler::ReadAbandonTimeout;
+const int BLEPollScheduler::MaxBackoffInterval;
+
+BLEPollScheduler::Scales BLEPollScheduler::CalculateScales(double averageRoundTrip, double hotDemand, double coldDemand)
+{
+    // Reads per millisecond the link can carry for polling, given the observed round trip.
+    // When the requested rates don't fit, hot channels are served first and cold ones share the rest,
+    // in total never more than the budget
+    Scales result;
+
+    if (averageRoundTrip <= 0)
+    {
+        return result;
+    }
+
+    const double budget = PollingLinkShare * MaxPendingReads / averageRoundTrip;
+    const double hotBudget = coldDemand > 0 ? budget * (1 - MinColdShare) : budget;
+
+    result.hot = qMax(1.0, hotDemand / hotBudget);
+
+    if (coldDemand > 0)
+    {
+        const double coldBudget = budget - hotDemand / result.hot;
+        result.cold = qMax(1.0, coldDemand / coldBudget);
+    }
+
+    return result;
+}
+
+void BLEPollScheduler::Add(const QBluetoothUuid &uuid, int targetInterval, bool hot, qint64 now)
+{
+    Entry entry;
+    entry.targetInterval = qMax(1, targetInterval);
+    entry.hot = hot;
+    entry.nextReadTime = now;
+
+    entries.insert(uuid, entry);
+
+    UpdateScales();
+}
+
+void BLEPollScheduler::Clear()
+{
+    entries.clear();
+    pendingReads = 0;
+    averageRoundTrip = 0;
+    scales = Scales();
+}
+
+bool BLEPollScheduler::IsEmpty() const
+{
+    return entries.isEmpty();
+}
+
+void BLEPollScheduler::SetHot(const QBluetoothUuid &uuid, bool hot)
+{
+    const auto it = entries.find(uuid);
+    if (it == entries.end() || it->hot == hot)
+    {
+        return;
+    }
+
+    it->hot = hot;
+
+    UpdateScales();
+}
+
+QBluetoothUuid BLEPollScheduler::TakeNextRead(qint64 now)
+{
+    if (pendingReads >= MaxPendingReads)
+    {
+        return QBluetoothUuid();
+    }
+
+    auto next = entries.end();
+
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->requestTime >= 0 || it->nextReadTime > now)
+        {
+            continue;
+        }
+
+        if (next == entries.end() || (it->hot && !next->hot) || (it->hot == next->hot && it->nextReadTime < next->nextReadTime))
+        {
+            next = it;
+        }
+    }
+
+    if (next == entries.end())
+    {
+        return QBluetoothUuid();
+    }
+
+    next->requestTime = now;
+    ++pendingReads;
+
+    return next.key();
+}
+
+void BLEPollScheduler::FinishRead(const QBluetoothUuid &uuid, bool succeeded, qint64 now)
+{
+    const auto it = entries.find(uuid);
+    if (it == entries.end() || it->requestTime < 0)
+    {
+        return;
+    }
+
+    Entry& entry = *it;
+
+    entry.lastRequestTime = entry.requestTime;
+    entry.requestTime = -1;
+    pendingReads = qMax(0, pendingReads - 1);
+
+    if (succeeded)
+    {
+        entry.failures = 0;
+
+        if (!entry.timedOut)
+        {
+            const double roundTrip = now - entry.lastRequestTime;
+            if (averageRoundTrip <= 0)
+            {
+                averageRoundTrip = roundTrip;
+            }
+            else
+            {
+                averageRoundTrip += (roundTrip - averageRoundTrip) * RoundTripSmoothing;
+            }
+        }
+    }
+    else
+    {
+        ++entry.failures;
+    }
+
+    entry.timedOut = false;
+
+    UpdateScales();
+}
+
+QBluetoothUuid BLEPollScheduler::OldestPendingRead(const std::function<bool (const QBluetoothUuid &)> &filter) const
+{
+    auto oldest = entries.cend();
+
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+    {
+        if (it->requestTime >= 0 && filter(it.key()) && (oldest == entries.cend() || it->requestTime < oldest->requestTime))
+        {
+            oldest = it;
+        }
+    }
+
+    return oldest == entries.cend() ? QBluetoothUuid() : oldest.key();
+}
+
+void BLEPollScheduler::CheckTimeouts(qint64 now)
+{
+    // A timed out read keeps its slot until the stack answers it, otherwise more requests than
+    // MaxPendingReads would be queued and the late answer would be taken for a new read
+    QList<QBluetoothUuid> abandoned;
+
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->requestTime < 0)
+        {
+            continue;
+        }
+
+        if (!it->timedOut && now - it->requestTime > ReadTimeout)
+        {
+            qDebug() << "read timeout" << it.key().toString();
+            it->timedOut = true;
+        }
+        else if (now - it->requestTime > ReadAbandonTimeout)
+        {
+            qDebug() << "read abandoned" << it.key().toString();
+            abandoned.append(it.key());
+        }
+    }
+
+    for (const QBluetoothUuid& uuid : abandoned)
+    {
+        FinishRead(uuid, false, now);
+    }
+}
+
+qint64 BLEPollScheduler::NextDeadline() const
+{
+    qint64 nextTime = -1;
+
+    for (const Entry& entry : entries)
+    {
+        qint64 time = -1;
+        if (entry.requestTime >= 0)
+        {
+            time = entry.requestTime + (entry.timedOut ? ReadAbandonTimeout : ReadTimeout) + 1;
+        }
+        else if (pendingReads < MaxPendingReads)
+        {
+            time = entry.nextReadTime;
+        }
+
+        if (time >= 0 && (nextTime < 0 || time < nextTime))
+        {
+            nextTime = time;
+        }
+    }
+
+    return nextTime;
+}
+
+bool BLEPollScheduler::IsPending(const QBluetoothUuid &uuid) const
+{
+    const auto it = entries.find(uuid);
+    return it != entries.end() && it->requestTime >= 0;
+}
+
+int BLEPollScheduler::PendingReads() const
+{
+    return pendingReads;
+}
+
+qint64 BLEPollScheduler::NextReadTime(const QBluetoothUuid &uuid) const
+{
+    return entries.value(uuid).nextReadTime;
+}
+
+double BLEPollScheduler::AverageRoundTrip() const
+{
+    return averageRoundTrip;
+}
+
+BLEPollScheduler::Scales BLEPollScheduler::CurrentScales() const
+{
+    return scales;
+}
+
+void BLEPollScheduler::UpdateScales()
+{
+    double hotDemand = 0;
+    double coldDemand = 0;
+    for (const Entry& entry : entries)
+    {
+        (entry.hot ? hotDemand : coldDemand) += 1.0 / entry.targetInterval;
+    }
+
+    scales = CalculateScales(averageRoundTrip, hotDemand, coldDemand);
+
+    // new rates apply right away, not after the next read of each channel
+    for (Entry& entry : entries)
+    {
+        if (entry.requestTime < 0)
+        {
+            Reschedule(entry);
+        }
+    }
+}
+
+void BLEPollScheduler::Reschedule(Entry &entry)
+{
+    if (entry.lastRequestTime < 0)
+    {
+        return;
+    }
+
+    double interval = entry.targetInterval * (entry.hot ? scales.hot : scales.cold);
+
+    // a characteristic that keeps failing (e.g. insufficient authentication) is retried less and less often
+    if (entry.failures > 0)
+    {
+        interval = qMax(interval, qMin(interval * double(1 << qMin(entry.failures, MaxBackoffShift)), double(MaxBackoffInterval)));
+    }
+
+    entry.nextReadTime = entry.lastRequestTime + qint64(interval);
+}
@@ -0,0 +1,69 @@
+#ifndef BLEPOLLSCHEDULER_H
+#define BLEPOLLSCHEDULER_H
+
+#include <QBluetoothUuid>
+#include <QHash>
+#include <functional>
+
+// Decides when characteristics without notifications are read. Knows nothing about the
+// Bluetooth stack, times are milliseconds of a monotonic clock passed in by the caller
+class BLEPollScheduler
+{
+public:
+    static const int MaxPendingReads = 2; // one request on air and one queued in the stack
+    static const int ReadTimeout = 2000;
+    static const int ReadAbandonTimeout = 10000; // the stack lost the request, free its slot
+    static const int MaxBackoffInterval = 30000;
+
+    struct Scales
+    {
+        double hot = 1;
+        double cold = 1;
+    };
+
+    // demands are in reads per millisecond
+    static Scales CalculateScales(double averageRoundTrip, double hotDemand, double coldDemand);
+
+    void Add(const QBluetoothUuid& uuid, int targetInterval, bool hot, qint64 now);
+    void Clear();
+    bool IsEmpty() const;
+
+    void SetHot(const QBluetoothUuid& uuid, bool hot);
+
+    // marks the most urgent due characteristic as requested, null uuid if none can be read now
+    QBluetoothUuid TakeNextRead(qint64 now);
+    void FinishRead(const QBluetoothUuid& uuid, bool succeeded, qint64 now);
+    QBluetoothUuid OldestPendingRead(const std::function<bool(const QBluetoothUuid&)>& filter) const;
+    void CheckTimeouts(qint64 now);
+
+    // -1 if nothing has to be done until a read completes
+    qint64 NextDeadline() const;
+
+    bool IsPending(const QBluetoothUuid& uuid) const;
+    int PendingReads() const;
+    qint64 NextReadTime(const QBluetoothUuid& uuid) const;
+    double AverageRoundTrip() const;
+    Scales CurrentScales() const;
+
+private:
+    struct Entry
+    {
+        int targetInterval = 0;
+        bool hot = false;
+        qint64 nextReadTime = 0;
+        qint64 lastRequestTime = -1;
+        qint64 requestTime = -1;
+        bool timedOut = false; // the round trip of a late answer isn't counted
+        int failures = 0;
+    };
+
+    void UpdateScales();
+    void Reschedule(Entry& entry);
+
+    QHash<QBluetoothUuid, Entry> entries;
+    int pendingReads = 0;
+    double averageRoundTrip = 0;
+    Scales scales;
+};
+
+#endif // BLEPOLLSCHEDULER_H
@@ -2,6 +2,8 @@
 #include <QDebug>
 #include <QBluetoothUuid>
 #include <QDataStream>
+#include <QLowEnergyConnectionParameters>
+#include <QtMath>
 
 namespace
 {
@@ -9,6 +11,13 @@ namespace
 const static int UpdateDeviceTimerInterval = 2000;
 const static int LowEnergyDiscoveryTimeout = 5000;
 
+const static int DefaultPollInterval = 100;
+
+const static int DefaultCommandInterval = 15; // used until the connection parameters are known
+const static int MaxQueuedCommands = 16;
+const static int MaxCommandsPerInterval = 4; // in total, the rest of each connection event is left for notifications
+const static int CommandWriteTimeout = 2000;
+
 }
 
 BLESimpleDevice::BLESimpleDevice(const QBluetoothAddress& targetDeviceAddress_, const TargetMeasurementData& targetMeasurementData_, QObject *parent)
@@ -27,13 +36,18 @@ BLESimpleDevice::BLESimpleDevice(const QBluetoothAddress& targetDeviceAddress_,
     timerUpdate.setInterval(UpdateDeviceTimerInterval);
     timerUpdate.start();
 
-    if (localDevice.hostMode() == QBluetoothLocalDevice::HostPoweredOff)
-    {
-        localDevice.powerOn();
-    }
+    connect(&timerPoll, &QTimer::timeout, this, &BLESimpleDevice::PollCharacteristics);
+    timerPoll.setSingleShot(true);
+    elapsedTimer.start();
+
+    connect(&timerCommands, &QTimer::timeout, this, &BLESimpleDevice::WriteCommands);
+    commandInterval = DefaultCommandInterval;
+    timerCommands.setInterval(commandInterval);
 
     DisconnectAndReset();
-    UpdateDevice();
+
+    // deferred, so that the stack can be replaced in a subclass
+    QTimer::singleShot(0, this, &BLESimpleDevice::Start);
 }
 
 BLESimpleDevice::State BLESimpleDevice::GetState() const
@@ -80,7 +94,7 @@ BLESimpleDevice::State BLESimpleDevice::GetState() const
             {
                 return State::DiscoveringServices;
             }
-            else if (!someDescriptorWritten)
+            else if (!someDescriptorWritten && !someCharacteristicRead)
             {
                 return State::ServicesDiscoveredAndDiscoveringDetails;
             }
@@ -216,6 +230,94 @@ double BLESimpleDevice::measuredValueDouble(const QString &name, const double &d
     return defaultValue;
 }
 
+void BLESimpleDevice::SetChannelHot(const QString &name, bool hot)
+{
+    if (hot)
+    {
+        hotChannels.insert(name);
+    }
+    else
+    {
+        hotChannels.remove(name);
+    }
+
+    for (auto it = polledCharacteristics.cbegin(); it != polledCharacteristics.cend(); ++it)
+    {
+        if (targetMeasurementData.characteristicNames.value(it.key()) == name)
+        {
+            pollScheduler.SetHot(it.key(), hot);
+        }
+    }
+
+    SchedulePoll();
+}
+
+bool BLESimpleDevice::SendCommand(const QString &name, const QByteArray &value, bool coalesce)
+{
+    // stats exist only for channels that were found on the device, unknown names aren't counted
+    const auto statsIt = commandStats.find(name);
+    if (statsIt == commandStats.end())
+    {
+        return false;
+    }
+
+    CommandStats& stats = *statsIt;
+
+    const auto it = commandChannels.find(name);
+    if (it == commandChannels.end())
+    {
+        ++stats.dropped;
+        return false;
+    }
+
+    QQueue<Command>& queue = it->queue;
+
+    if (coalesce && !queue.isEmpty() && queue.last().coalesce)
+    {
+        // state-like command, only the latest value matters
+        queue.last().value = value;
+        ++stats.coalesced;
+    }
+    else
+    {
+        Command command;
+        command.value = value;
+        command.coalesce = coalesce;
+        queue.enqueue(command);
+
+        if (queue.count() > MaxQueuedCommands)
+        {
+            queue.dequeue();
+            ++stats.dropped;
+        }
+    }
+
+    stats.queueDepth = queue.count();
+    stats.maxQueueDepth = qMax(stats.maxQueueDepth, stats.queueDepth);
+
+    if (!timerCommands.isActive())
+    {
+        timerCommands.start();
+
+        if (lastCommandsTime < 0 || elapsedTimer.elapsed() - lastCommandsTime >= commandInterval)
+        {
+            WriteCommands();
+        }
+    }
+
+    return true;
+}
+
+BLESimpleDevice::CommandStats BLESimpleDevice::GetCommandStats(const QString &name) const
+{
+    return commandStats.value(name);
+}
+
+int BLESimpleDevice::ServiceObjectCount() const
+{
+    return services.count();
+}
+
 void BLESimpleDevice::OnDeviceDiscovered(const QBluetoothDeviceInfo& deviceInfo)
 {
     qDebug() << "device discovered:" << deviceInfo.address() << ", name:" << deviceInfo.name() << ", rssi:" << deviceInfo.rssi();
@@ -278,19 +380,31 @@ void BLESimpleDevice::OnServiceDiscovered(const QBluetoothUuid &newServiceUUID)
 
     if (targetMeasurementData.servicesAndCharacteristics.contains(newServiceUUID))
     {
-        QLowEnergyService* newService = bleController->createServiceObject(newServiceUUID, this);
-
-        if (!newService)
+        if (services.contains(newServiceUUID))
         {
-            qCritical() << Q_FUNC_INFO << "!newService";
-            return;
+            qDebug() << "service" << newServiceUUID.toString() << "already created";
         }
+        else
+        {
+            BLESimpleDeviceService* newService = bleController->createServiceObject(newServiceUUID, this);
+
+            if (!newService)
+            {
+                qCritical() << Q_FUNC_INFO << "!newService";
+                return;
+            }
 
-        connect(newService, &QLowEnergyService::stateChanged, this, &BLESimpleDevice::OnServiceStateChanged);
-        connect(newService, &QLowEnergyService::characteristicChanged, this, &BLESimpleDevice::OnServiceCharacteristicChanged);
-        connect(newService, &QLowEnergyService::descriptorWritten, this, &BLESimpleDevice::OnServiceDescriptorWritten);
+            services.insert(newServiceUUID, newService);
 
-        newService->discoverDetails();
+            connect(newService, &BLESimpleDeviceService::stateChanged, this, &BLESimpleDevice::OnServiceStateChanged);
+            connect(newService, &BLESimpleDeviceService::characteristicChanged, this, &BLESimpleDevice::OnServiceCharacteristicChanged);
+            connect(newService, &BLESimpleDeviceService::descriptorWritten, this, &BLESimpleDevice::OnServiceDescriptorWritten);
+            connect(newService, &BLESimpleDeviceService::characteristicRead, this, &BLESimpleDevice::OnServiceCharacteristicRead);
+            connect(newService, &BLESimpleDeviceService::characteristicWritten, this, &BLESimpleDevice::OnServiceCharacteristicWritten);
+            connect(newService, &BLESimpleDeviceService::error, this, &BLESimpleDevice::OnServiceError);
+
+            newService->discoverDetails();
+        }
     }
 
     emit DeviceChanged();
@@ -306,7 +420,7 @@ void BLESimpleDevice::OnServiceStateChanged(QLowEnergyService::ServiceState newS
 {
     qDebug() << "OnServiceStateChanged, newState =" << newState;
 
-    QLowEnergyService* service = dynamic_cast<QLowEnergyService*>(sender());
+    BLESimpleDeviceService* service = dynamic_cast<BLESimpleDeviceService*>(sender());
     if (!service)
     {
         qCritical() << Q_FUNC_INFO << "!service";
@@ -340,8 +454,37 @@ void BLESimpleDevice::OnServiceStateChanged(QLowEnergyService::ServiceState newS
             {
                 service->writeDescriptor(notificationDesc, QByteArray::fromHex("0100"));
             }
+            else if ((hrChar.properties() & QLowEnergyCharacteristic::Read) &&
+                     (!IsCommandCharacteristic(hrChar) || targetMeasurementData.pollIntervals.contains(charUUID)))
+            {
+                qDebug() << "characteristic" << CharacteristicNameOrUUID(charUUID) << "has no notifications, will be polled";
+
+                PolledCharacteristic polled;
+                polled.service = service;
+                polled.characteristic = hrChar;
+                polledCharacteristics.insert(charUUID, polled);
+
+                pollScheduler.Add(charUUID, targetMeasurementData.pollIntervals.value(charUUID, DefaultPollInterval),
+                                  IsChannelHot(charUUID), elapsedTimer.elapsed());
+            }
+
+            if (IsCommandCharacteristic(hrChar))
+            {
+                const QString name = targetMeasurementData.characteristicNames.value(charUUID);
+
+                CommandChannel channel;
+                channel.service = service;
+                channel.characteristic = hrChar;
+                channel.writeMode = (hrChar.properties() & QLowEnergyCharacteristic::WriteNoResponse) ?
+                            QLowEnergyService::WriteWithoutResponse : QLowEnergyService::WriteWithResponse;
+
+                commandChannels.insert(name, channel);
+                commandStats[name];
+            }
         }
 
+        SchedulePoll();
+
         emit DeviceChanged();
     }
 }
@@ -352,11 +495,7 @@ void BLESimpleDevice::OnServiceCharacteristicChanged(const QLowEnergyCharacteris
     qDebug() << "OnServiceCharacteristicChanged" << CharacteristicNameOrUUID(characteristic.uuid()) << ", value =" << rawValue.toHex();
 #endif
 
-    const auto it = targetMeasurementData.characteristicNames.find(characteristic.uuid());
-    if (it != targetMeasurementData.characteristicNames.end())
-    {
-        measuredData.insert(*it, rawValue);
-    }
+    StoreMeasuredValue(characteristic.uuid(), rawValue);
 }
 
 void BLESimpleDevice::OnServiceDescriptorWritten(const QLowEnergyDescriptor &descriptor, const QByteArray &newValue)
@@ -370,6 +509,201 @@ void BLESimpleDevice::OnServiceDescriptorWritten(const QLowEnergyDescriptor &des
     emit DeviceChanged();
 }
 
+void BLESimpleDevice::OnServiceCharacteristicRead(const QLowEnergyCharacteristic &characteristic, const QByteArray &value)
+{
+#ifdef QT_DEBUG
+    qDebug() << "OnServiceCharacteristicRead" << CharacteristicNameOrUUID(characteristic.uuid()) << ", value =" << value.toHex();
+#endif
+
+    if (pollScheduler.IsPending(characteristic.uuid()))
+    {
+        pollScheduler.FinishRead(characteristic.uuid(), true, elapsedTimer.elapsed());
+        SchedulePoll();
+    }
+
+    StoreMeasuredValue(characteristic.uuid(), value);
+
+    if (!someCharacteristicRead)
+    {
+        someCharacteristicRead = true;
+        emit DeviceChanged();
+    }
+}
+
+void BLESimpleDevice::OnServiceError(QLowEnergyService::ServiceError error)
+{
+    qDebug() << "service error:" << error;
+
+    BLESimpleDeviceService* service = dynamic_cast<BLESimpleDeviceService*>(sender());
+
+    if (error == QLowEnergyService::CharacteristicWriteError)
+    {
+        // The error doesn't tell which write failed. It can only be pinned on the oldest pending write
+        // with response if nothing was written without response on the service since then
+        QString oldestName;
+        CommandChannel* oldest = nullptr;
+        QString latestName;
+        CommandChannel* latest = nullptr;
+
+        for (auto it = commandChannels.begin(); it != commandChannels.end(); ++it)
+        {
+            CommandChannel& channel = *it;
+            if (channel.service != service || channel.writeNumber == 0)
+            {
+                continue;
+            }
+
+            if (channel.writeTime >= 0 && (!oldest || channel.writeNumber < oldest->writeNumber))
+            {
+                oldest = &channel;
+                oldestName = it.key();
+            }
+            else if (channel.writeMode == QLowEnergyService::WriteWithoutResponse && (!latest || channel.writeNumber > latest->writeNumber))
+            {
+                latest = &channel;
+                latestName = it.key();
+            }
+        }
+
+        if (latest && (!oldest || latest->writeNumber > oldest->writeNumber))
+        {
+            ++commandStats[latestName].dropped;
+        }
+        else if (oldest)
+        {
+            oldest->writeTime = -1;
+            ++commandStats[oldestName].dropped;
+        }
+
+        return;
+    }
+
+    if (error != QLowEnergyService::CharacteristicReadError)
+    {
+        return;
+    }
+
+    // the error doesn't tell which characteristic failed, the stack completes requests in order
+    const QBluetoothUuid failed = pollScheduler.OldestPendingRead([this, service](const QBluetoothUuid& uuid) {
+        return polledCharacteristics.value(uuid).service == service;
+    });
+
+    if (!failed.isNull())
+    {
+        pollScheduler.FinishRead(failed, false, elapsedTimer.elapsed());
+        SchedulePoll();
+    }
+}
+
+void BLESimpleDevice::OnServiceCharacteristicWritten(const QLowEnergyCharacteristic &characteristic, const QByteArray &newValue)
+{
+    Q_UNUSED(newValue)
+
+    const auto it = commandChannels.find(targetMeasurementData.characteristicNames.value(characteristic.uuid()));
+    if (it != commandChannels.end())
+    {
+        it->writeTime = -1;
+    }
+}
+
+void BLESimpleDevice::PollCharacteristics()
+{
+    const qint64 now = elapsedTimer.elapsed();
+
+    pollScheduler.CheckTimeouts(now);
+
+    for (QBluetoothUuid uuid = pollScheduler.TakeNextRead(now); !uuid.isNull(); uuid = pollScheduler.TakeNextRead(now))
+    {
+        const PolledCharacteristic polled = polledCharacteristics.value(uuid);
+        polled.service->readCharacteristic(polled.characteristic);
+    }
+
+    SchedulePoll();
+}
+
+void BLESimpleDevice::SchedulePoll()
+{
+    // single shot timer for the nearest deadline, so an idle link doesn't wake the CPU
+    const qint64 nextTime = pollScheduler.NextDeadline();
+    if (nextTime < 0)
+    {
+        timerPoll.stop();
+        return;
+    }
+
+    timerPoll.start(int(qMax<qint64>(0, nextTime - elapsedTimer.elapsed())));
+}
+
+void BLESimpleDevice::WriteCommands()
+{
+    // Called once per connection interval. At most MaxCommandsPerInterval commands are written per call,
+    // one per channel, so that commands don't crowd out notifications. The first channel rotates,
+    // a busy channel can't starve the others
+    const qint64 now = elapsedTimer.elapsed();
+    bool somePending = false;
+
+    for (auto it = commandChannels.begin(); it != commandChannels.end(); ++it)
+    {
+        CommandChannel& channel = *it;
+
+        if (channel.writeTime >= 0 && now - channel.writeTime > CommandWriteTimeout)
+        {
+            qDebug() << "command write timeout" << it.key();
+            channel.writeTime = -1;
+            ++commandStats[it.key()].dropped;
+        }
+    }
+
+    const QStringList names = commandChannels.keys();
+    int written = 0;
+
+    for (int i = 0; i < names.count(); ++i)
+    {
+        const int index = (nextCommandChannel + i) % names.count();
+        CommandChannel& channel = commandChannels[names[index]];
+
+        if (channel.writeTime >= 0)
+        {
+            somePending = true;
+            continue;
+        }
+
+        if (channel.queue.isEmpty())
+        {
+            continue;
+        }
+
+        if (written >= MaxCommandsPerInterval)
+        {
+            somePending = true;
+            continue;
+        }
+
+        const Command command = channel.queue.dequeue();
+        channel.service->writeCharacteristic(channel.characteristic, command.value, channel.writeMode);
+        channel.writeNumber = ++commandWriteCount;
+
+        if (channel.writeMode == QLowEnergyService::WriteWithResponse)
+        {
+            channel.writeTime = now;
+        }
+
+        CommandStats& stats = commandStats[names[index]];
+        ++stats.sent;
+        stats.queueDepth = channel.queue.count();
+
+        ++written;
+        nextCommandChannel = index + 1;
+        lastCommandsTime = now;
+        somePending = true;
+    }
+
+    if (!somePending)
+    {
+        timerCommands.stop();
+    }
+}
+
 void BLESimpleDevice::StartDeviceDiscovery()
 {
     qDebug() << "start discovery target device: " << targetDeviceAddress;
@@ -378,7 +712,7 @@ void BLESimpleDevice::StartDeviceDiscovery()
 
     if (!deviceDiscoveryAgent.isActive())
     {
-        deviceDiscoveryAgent.start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
+        StartScan();
     }
 
     emit DeviceChanged();
@@ -388,24 +722,29 @@ void BLESimpleDevice::StartServiceDiscovery(const QBluetoothDeviceInfo &deviceIn
 {
     if (!bleController)
     {
-        bleController = QLowEnergyController::createCentral(deviceInfo, this);
+        bleController = CreateTransport(deviceInfo);
 
-        connect(bleController, &QLowEnergyController::serviceDiscovered, this, &BLESimpleDevice::OnServiceDiscovered);
-        connect(bleController, &QLowEnergyController::discoveryFinished, this, &BLESimpleDevice::OnServiceDiscoverFinished);
+        connect(bleController, &BLESimpleDeviceTransport::serviceDiscovered, this, &BLESimpleDevice::OnServiceDiscovered);
+        connect(bleController, &BLESimpleDeviceTransport::discoveryFinished, this, &BLESimpleDevice::OnServiceDiscoverFinished);
 
-        connect(bleController, static_cast<void (QLowEnergyController::*)(QLowEnergyController::Error)>(&QLowEnergyController::error),
-                this, [this](QLowEnergyController::Error error) {
+        connect(bleController, &BLESimpleDeviceTransport::error, this, [this](QLowEnergyController::Error error) {
             qDebug() << "services discovery error:" << error;
             DisconnectAndReset();
             UpdateDevice();
         });
 
-        connect(bleController, &QLowEnergyController::connected, this, [this]() {
+        connect(bleController, &BLESimpleDeviceTransport::connectionUpdated, this, [this](const QLowEnergyConnectionParameters& parameters) {
+            qDebug() << "connection parameters updated, interval =" << parameters.minimumInterval() << "-" << parameters.maximumInterval() << "ms";
+            commandInterval = qMax(1, qCeil(parameters.maximumInterval()));
+            timerCommands.setInterval(commandInterval);
+        });
+
+        connect(bleController, &BLESimpleDeviceTransport::connected, this, [this]() {
             qDebug() << "QLowEnergyController connected. Search services...";
             bleController->discoverServices();
         });
 
-        connect(bleController, &QLowEnergyController::disconnected, this, [this]() {
+        connect(bleController, &BLESimpleDeviceTransport::disconnected, this, [this]() {
             qDebug() << "LowEnergy controller disconnected";
             DisconnectAndReset();
             UpdateDevice();
@@ -415,6 +754,30 @@ void BLESimpleDevice::StartServiceDiscovery(const QBluetoothDeviceInfo &deviceIn
     bleController->connectToDevice();
 }
 
+BLESimpleDeviceTransport *BLESimpleDevice::CreateTransport(const QBluetoothDeviceInfo &deviceInfo)
+{
+    return new QtBLESimpleDeviceTransport(deviceInfo, this);
+}
+
+void BLESimpleDevice::PowerOnLocalDevice()
+{
+    if (localDevice.hostMode() == QBluetoothLocalDevice::HostPoweredOff)
+    {
+        localDevice.powerOn();
+    }
+}
+
+void BLESimpleDevice::StartScan()
+{
+    deviceDiscoveryAgent.start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
+}
+
+void BLESimpleDevice::Start()
+{
+    PowerOnLocalDevice();
+    UpdateDevice();
+}
+
 void BLESimpleDevice::UpdateDevice()
 {
     switch (GetState()) {
@@ -465,10 +828,72 @@ void BLESimpleDevice::DisconnectAndReset()
         bleController->disconnectFromDevice();
     }
 
+    timerPoll.stop();
+    polledCharacteristics.clear();
+    pollScheduler.Clear();
+
+    ReleaseCommandChannels();
+    ReleaseServices();
+
     measuredData.clear();
+    emit MeasuredDataCleared();
 
     targetDeviceFound = false;
     serviceDiscoverFinished = false;
     someDescriptorWritten = false;
+    someCharacteristicRead = false;
     androidMaybeNoLocationPermitionError = false;
 }
+
+void BLESimpleDevice::ReleaseServices()
+{
+    // QLowEnergyService objects become invalid after disconnect and can't be reused,
+    // so they are deleted here and created again on the next service discovery
+    for (BLESimpleDeviceService* service : services)
+    {
+        disconnect(service, nullptr, this, nullptr);
+        service->deleteLater();
+    }
+
+    services.clear();
+}
+
+void BLESimpleDevice::StoreMeasuredValue(const QBluetoothUuid &uuid, const QByteArray &value)
+{
+    const auto it = targetMeasurementData.characteristicNames.find(uuid);
+    if (it != targetMeasurementData.characteristicNames.end())
+    {
+        measuredData.insert(*it, value);
+        emit MeasuredValueChanged(*it, value);
+    }
+}
+
+bool BLESimpleDevice::IsCommandCharacteristic(const QLowEnergyCharacteristic &characteristic) const
+{
+    return !targetMeasurementData.characteristicNames.value(characteristic.uuid()).isEmpty() &&
+            (characteristic.properties() & (QLowEnergyCharacteristic::Write | QLowEnergyCharacteristic::WriteNoResponse));
+}
+
+bool BLESimpleDevice::IsChannelHot(const QBluetoothUuid &uuid) const
+{
+    return hotChannels.contains(targetMeasurementData.characteristicNames.value(uuid));
+}
+
+void BLESimpleDevice::ReleaseCommandChannels()
+{
+    timerCommands.stop();
+
+    for (auto it = commandChannels.cbegin(); it != commandChannels.cend(); ++it)
+    {
+        CommandStats& stats = commandStats[it.key()];
+        stats.dropped += it->queue.count();
+        stats.queueDepth = 0;
+    }
+
+    commandChannels.clear();
+    nextCommandChannel = 0;
+
+    // the next connection may have other parameters
+    commandInterval = DefaultCommandInterval;
+    timerCommands.setInterval(commandInterval);
+}
@@ -6,7 +6,11 @@
 #include <QBluetoothDeviceInfo>
 #include <QLowEnergyController>
 #include <QBluetoothLocalDevice>
+#include "blesimpledevicetransport.h"
+#include "blepollscheduler.h"
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QQueue>
 
 class BLESimpleDevice : public QObject
 {
@@ -29,6 +33,16 @@ public:
     {
         QMap<QBluetoothUuid, QSet<QBluetoothUuid>> servicesAndCharacteristics; //keys = service, value = characteristic
         QHash<QBluetoothUuid, QString> characteristicNames;
+        QHash<QBluetoothUuid, int> pollIntervals; //ms, for characteristics without notifications, writable ones are polled only if listed here
+    };
+
+    struct CommandStats
+    {
+        int queueDepth = 0;
+        int maxQueueDepth = 0;
+        quint64 sent = 0;
+        quint64 coalesced = 0;
+        quint64 dropped = 0; // overflowed, lost on disconnect, failed or timed out
     };
 
     explicit BLESimpleDevice(const QBluetoothAddress& targetDeviceAddress, const TargetMeasurementData& targetMeasurementData, QObject *parent = nullptr);
@@ -41,8 +55,23 @@ public:
     quint32     measuredValueUInt32 (const QString& name, const quint32&    defaultValue = 0,               bool* ok = nullptr) const;
     double      measuredValueDouble (const QString& name, const double&     defaultValue = 0,               bool* ok = nullptr) const;
 
+    void SetChannelHot(const QString& name, bool hot);
+
+    bool SendCommand(const QString& name, const QByteArray& value, bool coalesce = true);
+    CommandStats GetCommandStats(const QString& name) const;
+
+    int ServiceObjectCount() const;
+
+protected:
+    // the Bluetooth stack, overridden by tests
+    virtual BLESimpleDeviceTransport* CreateTransport(const QBluetoothDeviceInfo& deviceInfo);
+    virtual void PowerOnLocalDevice();
+    virtual void StartScan();
+
 signals:
     void DeviceChanged();
+    void MeasuredValueChanged(const QString& name, const QByteArray& value);
+    void MeasuredDataCleared();
 
 private slots:
     void OnDeviceDiscovered(const QBluetoothDeviceInfo& deviceInfo);
@@ -56,13 +85,50 @@ private slots:
     void OnServiceStateChanged(QLowEnergyService::ServiceState newState);
     void OnServiceCharacteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &newValue);
     void OnServiceDescriptorWritten(const QLowEnergyDescriptor &descriptor, const QByteArray &newValue);
+    void OnServiceCharacteristicRead(const QLowEnergyCharacteristic &characteristic, const QByteArray &value);
+    void OnServiceError(QLowEnergyService::ServiceError error);
+
+    void OnServiceCharacteristicWritten(const QLowEnergyCharacteristic &characteristic, const QByteArray &newValue);
+
+    void PollCharacteristics();
+    void WriteCommands();
 
     void StartDeviceDiscovery();
     void StartServiceDiscovery(const QBluetoothDeviceInfo& deviceInfo);
     void UpdateDevice();
     void DisconnectAndReset();
+    void Start();
 
 private:
+    struct PolledCharacteristic
+    {
+        BLESimpleDeviceService* service = nullptr;
+        QLowEnergyCharacteristic characteristic;
+    };
+
+    struct Command
+    {
+        QByteArray value;
+        bool coalesce = false;
+    };
+
+    struct CommandChannel
+    {
+        BLESimpleDeviceService* service = nullptr;
+        QLowEnergyCharacteristic characteristic;
+        QLowEnergyService::WriteMode writeMode = QLowEnergyService::WriteWithResponse;
+        QQueue<Command> queue;
+        qint64 writeTime = -1; // only for writes with response
+        quint64 writeNumber = 0; // order of the last write among all channels
+    };
+
+    void ReleaseServices();
+    void ReleaseCommandChannels();
+    void StoreMeasuredValue(const QBluetoothUuid& uuid, const QByteArray& value);
+    void SchedulePoll();
+    bool IsCommandCharacteristic(const QLowEnergyCharacteristic& characteristic) const;
+    bool IsChannelHot(const QBluetoothUuid& uuid) const;
+
     QString CharacteristicNameOrUUID(const QBluetoothUuid& uuid);
 
     const QBluetoothAddress targetDeviceAddress;
@@ -72,7 +138,22 @@ private:
 
     QBluetoothLocalDevice localDevice;
 
-    QLowEnergyController *bleController = nullptr;
+    BLESimpleDeviceTransport *bleController = nullptr;
+    QHash<QBluetoothUuid, BLESimpleDeviceService*> services;
+
+    QHash<QBluetoothUuid, PolledCharacteristic> polledCharacteristics;
+    QSet<QString> hotChannels;
+    BLEPollScheduler pollScheduler;
+    QTimer timerPoll;
+    QElapsedTimer elapsedTimer;
+
+    QHash<QString, CommandChannel> commandChannels;
+    QHash<QString, CommandStats> commandStats;
+    QTimer timerCommands;
+    int commandInterval = 0;
+    qint64 lastCommandsTime = -1;
+    quint64 commandWriteCount = 0;
+    int nextCommandChannel = 0; // round robin start of the next interval
 
     QTimer timerUpdate;
     QBluetoothDeviceDiscoveryAgent deviceDiscoveryAgent;
@@ -80,6 +161,7 @@ private:
     bool targetDeviceFound = false;
     bool serviceDiscoverFinished = false;
     bool someDescriptorWritten = false;
+    bool someCharacteristicRead = false;
     bool androidMaybeNoLocationPermitionError = false;
 };
 
@@ -0,0 +1,369 @@
+#include "blesimpledeviceapi_p.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <cstring>
+#include <cstddef>
+
+static_assert(int(BLESD_STATE_UNKNOWN) == int(BLESimpleDevice::Unknown), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_BLUETOOTH_NOT_AVAILABLE) == int(BLESimpleDevice::BluetoothNotAvailable), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_BLUETOOTH_NOT_ENABLED) == int(BLESimpleDevice::BluetoothNotEnabled), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_ANDROID_MAYBE_NO_LOCATION_PERMITION_ERROR) == int(BLESimpleDevice::AndroidMaybeNoLocationPermitionError), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_NOT_CONNECTED) == int(BLESimpleDevice::NotConnected), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_DISCOVERING_DEVICE) == int(BLESimpleDevice::DiscoveringDevice), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_DEVICE_FOUND_WAIT_TO_SERVICES_DISCOVERING) == int(BLESimpleDevice::DeviceFoundWaitToServicesDiscovering), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_DISCOVERING_SERVICES) == int(BLESimpleDevice::DiscoveringServices), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_SERVICES_DISCOVERED_AND_DISCOVERING_DETAILS) == int(BLESimpleDevice::ServicesDiscoveredAndDiscoveringDetails), "BLESDState mismatch");
+static_assert(int(BLESD_STATE_CONNECTED) == int(BLESimpleDevice::Connected), "BLESDState mismatch");
+
+// hosts map BLESDSample arrays directly (e.g. numpy, C# StructLayout), the layout must not drift
+static_assert(sizeof(BLESDSample) == 56, "BLESDSample layout changed");
+static_assert(offsetof(BLESDSample, timestampUs) == 0, "BLESDSample layout changed");
+static_assert(offsetof(BLESDSample, channel) == 8, "BLESDSample layout changed");
+static_assert(offsetof(BLESDSample, data) == 24, "BLESDSample layout changed");
+
+namespace
+{
+
+const static int DefaultSampleBufferCapacity = 1024;
+
+// config structures from older callers are shorter, missing fields stay zero
+const static int MinDeviceConfigSize = int(offsetof(BLESDDeviceConfig, sampleBufferCapacity) + sizeof(int32_t));
+const static int MinChannelConfigSize = int(offsetof(BLESDChannelConfig, pollIntervalMs) + sizeof(int32_t));
+
+int ApplicationArgc = 1;
+char ApplicationName[] = "BLESimpleDevice";
+char* ApplicationArgv[] = { ApplicationName, nullptr };
+
+QBluetoothUuid UuidFromString(const char* text)
+{
+    const QString string = QString::fromUtf8(text ? text : "").trimmed();
+
+    if (string.length() <= 8)
+    {
+        bool ok = false;
+        const quint32 value = string.toUInt(&ok, 16);
+        if (!ok)
+        {
+            return QBluetoothUuid();
+        }
+
+        return string.length() <= 4 ? QBluetoothUuid(quint16(value)) : QBluetoothUuid(value);
+    }
+
+    return QBluetoothUuid(string);
+}
+
+void FillSample(BLESDSample& sample, int channel, qint64 timestampUs, const QByteArray& value)
+{
+    const int size = qMin(value.size(), BLESD_MAX_VALUE_SIZE);
+
+    sample.timestampUs = timestampUs;
+    sample.channel = channel;
+    sample.flags = BLESD_SAMPLE_VALID | (value.size() > BLESD_MAX_VALUE_SIZE ? BLESD_SAMPLE_TRUNCATED : 0);
+    sample.size = size;
+    sample.reserved = 0;
+    std::memcpy(sample.data, value.constData(), size_t(size));
+}
+
+}
+
+void BLESDDevice::Destroy()
+{
+    if (callbackDepth > 0)
+    {
+        // called from a callback, the device is still emitting a signal
+        destroyRequested = true;
+        return;
+    }
+
+    if (destroyRequested)
+    {
+        QObject::disconnect(device, nullptr, nullptr, nullptr);
+        device->deleteLater();
+    }
+    else
+    {
+        delete device;
+    }
+
+    delete this;
+}
+
+void BLESDDevice::Notify(int32_t event)
+{
+    if (!callback)
+    {
+        return;
+    }
+
+    ++callbackDepth;
+    callback(this, event, userData);
+    --callbackDepth;
+
+    if (destroyRequested && callbackDepth == 0)
+    {
+        Destroy();
+    }
+}
+
+void BLESDDevice::OnMeasuredDataCleared()
+{
+    for (BLESDSample& value : values)
+    {
+        value.flags = 0;
+    }
+}
+
+void BLESDDevice::OnMeasuredValueChanged(const QString& name, const QByteArray& value)
+{
+    const auto it = channelIndexes.find(name);
+    if (it == channelIndexes.end())
+    {
+        return;
+    }
+
+    const qint64 timestampUs = elapsedTimer.nsecsElapsed() / 1000;
+
+    FillSample(values[*it], *it, timestampUs, value);
+
+    if (samples.isEmpty())
+    {
+        return;
+    }
+
+    if (samplesCount == samples.count())
+    {
+        samplesStart = (samplesStart + 1) % samples.count();
+        --samplesCount;
+        ++droppedSamples;
+    }
+
+    FillSample(samples[(samplesStart + samplesCount) % samples.count()], *it, timestampUs, value);
+    ++samplesCount;
+
+    if (samplesCount == 1)
+    {
+        Notify(BLESD_EVENT_SAMPLES_AVAILABLE);
+    }
+}
+
+int32_t blesd_api_version()
+{
+    return BLESD_API_VERSION;
+}
+
+BLESDDevice* blesd_create(const BLESDDeviceConfig* deviceConfig)
+{
+    return blesd_create_with_factory(deviceConfig, [](const QBluetoothAddress& address, const BLESimpleDevice::TargetMeasurementData& tmd) {
+        return new BLESimpleDevice(address, tmd);
+    });
+}
+
+BLESDDevice* blesd_create_with_factory(const BLESDDeviceConfig* deviceConfig, const BLESDDeviceFactory& factory)
+{
+    if (!deviceConfig || deviceConfig->structSize < MinDeviceConfigSize)
+    {
+        return nullptr;
+    }
+
+    BLESDDeviceConfig config;
+    std::memset(&config, 0, sizeof(config));
+    std::memcpy(&config, deviceConfig, qMin(size_t(deviceConfig->structSize), sizeof(config)));
+
+    if (!config.address || config.channelCount < 0 || (config.channelCount > 0 && (!config.channels || config.channelStructSize < MinChannelConfigSize)))
+    {
+        return nullptr;
+    }
+
+    const QBluetoothAddress address(QString::fromUtf8(config.address));
+    if (address.isNull())
+    {
+        qCritical() << Q_FUNC_INFO << "invalid address" << config.address;
+        return nullptr;
+    }
+
+    if (!QCoreApplication::instance())
+    {
+        // the host has no Qt event loop, it's driven with blesd_process_events()
+        new QCoreApplication(ApplicationArgc, ApplicationArgv);
+    }
+
+    BLESimpleDevice::TargetMeasurementData tmd;
+    QStringList names;
+
+    for (int i = 0; i < config.channelCount; ++i)
+    {
+        BLESDChannelConfig channel;
+        std::memset(&channel, 0, sizeof(channel));
+        std::memcpy(&channel, reinterpret_cast<const char*>(config.channels) + size_t(i) * size_t(config.channelStructSize),
+                    qMin(size_t(config.channelStructSize), sizeof(channel)));
+
+        const QBluetoothUuid serviceUuid = UuidFromString(channel.serviceUuid);
+        const QBluetoothUuid characteristicUuid = UuidFromString(channel.characteristicUuid);
+        const QString name = QString::fromUtf8(channel.name ? channel.name : "");
+
+        if (serviceUuid.isNull() || characteristicUuid.isNull() || name.isEmpty() || names.contains(name) ||
+            tmd.characteristicNames.contains(characteristicUuid))
+        {
+            qCritical() << Q_FUNC_INFO << "invalid channel" << i;
+            return nullptr;
+        }
+
+        tmd.servicesAndCharacteristics[serviceUuid].insert(characteristicUuid);
+        tmd.characteristicNames.insert(characteristicUuid, name);
+
+        if (channel.pollIntervalMs > 0)
+        {
+            tmd.pollIntervals.insert(characteristicUuid, channel.pollIntervalMs);
+        }
+
+        names.append(name);
+    }
+
+    BLESDDevice* handle = new BLESDDevice();
+
+    for (int i = 0; i < names.count(); ++i)
+    {
+        handle->channelIndexes.insert(names[i], i);
+    }
+
+    handle->values.resize(names.count());
+    for (int i = 0; i < handle->values.count(); ++i)
+    {
+        std::memset(&handle->values[i], 0, sizeof(BLESDSample));
+        handle->values[i].channel = i;
+    }
+
+    handle->samples.resize(config.sampleBufferCapacity > 0 ? config.sampleBufferCapacity : DefaultSampleBufferCapacity);
+    handle->elapsedTimer.start();
+
+    handle->device = factory(address, tmd);
+
+    QObject::connect(handle->device, &BLESimpleDevice::MeasuredValueChanged, handle->device, [handle](const QString& name, const QByteArray& value) {
+        handle->OnMeasuredValueChanged(name, value);
+    });
+
+    QObject::connect(handle->device, &BLESimpleDevice::MeasuredDataCleared, handle->device, [handle]() {
+        handle->OnMeasuredDataCleared();
+    });
+
+    QObject::connect(handle->device, &BLESimpleDevice::DeviceChanged, handle->device, [handle]() {
+        handle->Notify(BLESD_EVENT_DEVICE_CHANGED);
+    });
+
+    return handle;
+}
+
+void blesd_destroy(BLESDDevice* device)
+{
+    if (!device)
+    {
+        return;
+    }
+
+    device->Destroy();
+}
+
+void blesd_set_callback(BLESDDevice* device, BLESDCallback callback, void* userData)
+{
+    if (!device)
+    {
+        return;
+    }
+
+    device->callback = callback;
+    device->userData = userData;
+}
+
+void blesd_process_events(int32_t maxTimeMs)
+{
+    if (!QCoreApplication::instance())
+    {
+        return;
+    }
+
+    QCoreApplication::processEvents(QEventLoop::AllEvents, maxTimeMs);
+
+    // devices destroyed from a callback, processEvents() alone doesn't run deferred deletes outside exec()
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+int32_t blesd_get_state(const BLESDDevice* device)
+{
+    if (!device)
+    {
+        return BLESD_STATE_UNKNOWN;
+    }
+
+    return device->device->GetState();
+}
+
+int32_t blesd_channel_count(const BLESDDevice* device)
+{
+    if (!device)
+    {
+        return 0;
+    }
+
+    return device->values.count();
+}
+
+int32_t blesd_read_values(const BLESDDevice* device, BLESDSample* samples, int32_t capacity)
+{
+    if (!device || !samples || capacity <= 0)
+    {
+        return 0;
+    }
+
+    const int count = qMin(capacity, device->values.count());
+    std::memcpy(samples, device->values.constData(), sizeof(BLESDSample) * size_t(count));
+
+    return count;
+}
+
+int32_t blesd_drain_samples(BLESDDevice* device, BLESDSample* samples, int32_t capacity)
+{
+    if (!device || !samples || capacity <= 0)
+    {
+        return 0;
+    }
+
+    const int count = qMin(capacity, device->samplesCount);
+    const int bufferSize = device->samples.count();
+
+    // at most two contiguous parts of the ring buffer
+    const int firstPart = qMin(count, bufferSize - device->samplesStart);
+    std::memcpy(samples, device->samples.constData() + device->samplesStart, sizeof(BLESDSample) * size_t(firstPart));
+    std::memcpy(samples + firstPart, device->samples.constData(), sizeof(BLESDSample) * size_t(count - firstPart));
+
+    if (bufferSize > 0)
+    {
+        device->samplesStart = (device->samplesStart + count) % bufferSize;
+    }
+
+    device->samplesCount -= count;
+
+    return count;
+}
+
+int64_t blesd_dropped_samples(const BLESDDevice* device)
+{
+    if (!device)
+    {
+        return 0;
+    }
+
+    return device->droppedSamples;
+}
+
+int32_t blesd_send_command(BLESDDevice* device, const char* name, const uint8_t* data, int32_t size, int32_t coalesce)
+{
+    if (!device || !name || (size > 0 && !data) || size < 0)
+    {
+        return 0;
+    }
+
+    const QByteArray value(reinterpret_cast<const char*>(data), size);
+
+    return device->device->SendCommand(QString::fromUtf8(name), value, coalesce != 0) ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#ifndef BLESIMPLEDEVICEAPI_H
+#define BLESIMPLEDEVICEAPI_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#   if defined(BLESIMPLEDEVICE_LIBRARY)
+#       define BLESD_API __declspec(dllexport)
+#   else
+#       define BLESD_API __declspec(dllimport)
+#   endif
+#else
+#   define BLESD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* incremented on incompatible changes; new fields are only appended to the config structures */
+#define BLESD_API_VERSION 1
+
+#define BLESD_MAX_VALUE_SIZE 32
+
+/* same values as BLESimpleDevice::State */
+enum BLESDState
+{
+    BLESD_STATE_UNKNOWN = 100,
+    BLESD_STATE_BLUETOOTH_NOT_AVAILABLE,
+    BLESD_STATE_BLUETOOTH_NOT_ENABLED,
+    BLESD_STATE_ANDROID_MAYBE_NO_LOCATION_PERMITION_ERROR,
+    BLESD_STATE_NOT_CONNECTED,
+    BLESD_STATE_DISCOVERING_DEVICE,
+    BLESD_STATE_DEVICE_FOUND_WAIT_TO_SERVICES_DISCOVERING,
+    BLESD_STATE_DISCOVERING_SERVICES,
+    BLESD_STATE_SERVICES_DISCOVERED_AND_DISCOVERING_DETAILS,
+    BLESD_STATE_CONNECTED
+};
+
+enum BLESDEvent
+{
+    BLESD_EVENT_DEVICE_CHANGED = 1,
+    BLESD_EVENT_SAMPLES_AVAILABLE = 2 /* first sample after the buffer was drained */
+};
+
+enum BLESDSampleFlags
+{
+    BLESD_SAMPLE_VALID = 1,
+    BLESD_SAMPLE_TRUNCATED = 2 /* value was longer than BLESD_MAX_VALUE_SIZE */
+};
+
+typedef struct BLESDDevice BLESDDevice;
+
+typedef void (*BLESDCallback)(BLESDDevice* device, int32_t event, void* userData);
+
+typedef struct BLESDChannelConfig
+{
+    const char* serviceUuid;        /* "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}" or short hex form, e.g. "1101" */
+    const char* characteristicUuid;
+    const char* name;
+    int32_t pollIntervalMs;         /* 0 = default, used only for characteristics without notifications */
+} BLESDChannelConfig;
+
+typedef struct BLESDDeviceConfig
+{
+    int32_t structSize;             /* sizeof(BLESDDeviceConfig) */
+    int32_t channelStructSize;      /* sizeof(BLESDChannelConfig), stride of channels */
+    const char* address;            /* "30:7B:F5:33:2B:9D" */
+    const BLESDChannelConfig* channels;
+    int32_t channelCount;
+    int32_t sampleBufferCapacity;   /* 0 = default */
+} BLESDDeviceConfig;
+
+/* layout is fixed for a given BLESD_API_VERSION */
+typedef struct BLESDSample
+{
+    int64_t timestampUs;            /* since the device was created */
+    int32_t channel;                /* index in BLESDDeviceConfig::channels */
+    int32_t flags;
+    int32_t size;
+    int32_t reserved;
+    uint8_t data[BLESD_MAX_VALUE_SIZE];
+} BLESDSample;
+
+/* All functions must be called from the same thread. Callbacks are called from blesd_process_events(),
+   blesd_destroy() may be called from a callback */
+
+BLESD_API int32_t       blesd_api_version       (void);
+
+BLESD_API BLESDDevice*  blesd_create            (const BLESDDeviceConfig* config);
+BLESD_API void          blesd_destroy           (BLESDDevice* device);
+BLESD_API void          blesd_set_callback      (BLESDDevice* device, BLESDCallback callback, void* userData);
+BLESD_API void          blesd_process_events    (int32_t maxTimeMs);
+
+BLESD_API int32_t       blesd_get_state         (const BLESDDevice* device);
+BLESD_API int32_t       blesd_channel_count     (const BLESDDevice* device);
+
+/* copies the current value of every channel, in channel order; returns the number of samples written */
+BLESD_API int32_t       blesd_read_values       (const BLESDDevice* device, BLESDSample* samples, int32_t capacity);
+/* moves buffered samples, oldest first; returns the number of samples written */
+BLESD_API int32_t       blesd_drain_samples     (BLESDDevice* device, BLESDSample* samples, int32_t capacity);
+BLESD_API int64_t       blesd_dropped_samples   (const BLESDDevice* device);
+
+/* returns 0 if the channel is not writable or not connected */
+BLESD_API int32_t       blesd_send_command      (BLESDDevice* device, const char* name, const uint8_t* data, int32_t size, int32_t coalesce);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLESIMPLEDEVICEAPI_H
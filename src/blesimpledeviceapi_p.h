@@ -0,0 +1,47 @@
+#ifndef BLESIMPLEDEVICEAPI_P_H
+#define BLESIMPLEDEVICEAPI_P_H
+
+// Internals of the C API, not part of the library interface. Used by blesimpledeviceapi.cpp and by tests
+
+#include "blesimpledeviceapi.h"
+#include "blesimpledevice.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <functional>
+
+struct BLESDDevice
+{
+    BLESimpleDevice* device = nullptr;
+    QHash<QString, int> channelIndexes;
+
+    QVector<BLESDSample> values;
+
+    QVector<BLESDSample> samples; // ring buffer
+    int samplesStart = 0;
+    int samplesCount = 0;
+    qint64 droppedSamples = 0;
+
+    BLESDCallback callback = nullptr;
+    void* userData = nullptr;
+
+    QElapsedTimer elapsedTimer;
+
+    int callbackDepth = 0;
+    bool destroyRequested = false;
+
+    void Destroy();
+
+    // must be the last use of this object in the caller, the host may destroy the device from the callback
+    void Notify(int32_t event);
+
+    void OnMeasuredDataCleared();
+    void OnMeasuredValueChanged(const QString& name, const QByteArray& value);
+};
+
+typedef std::function<BLESimpleDevice*(const QBluetoothAddress& address, const BLESimpleDevice::TargetMeasurementData& tmd)> BLESDDeviceFactory;
+
+// blesd_create() with a replaceable device, e.g. one without the Bluetooth stack
+BLESDDevice* blesd_create_with_factory(const BLESDDeviceConfig* config, const BLESDDeviceFactory& factory);
+
+#endif // BLESIMPLEDEVICEAPI_P_H
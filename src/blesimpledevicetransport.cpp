@@ -0,0 +1,85 @@
+#include "blesimpledevicetransport.h"
+
+QtBLESimpleDeviceService::QtBLESimpleDeviceService(QLowEnergyService *service_, QObject *parent)
+    : BLESimpleDeviceService(parent)
+    , service(service_)
+{
+    service->setParent(this);
+
+    connect(service, &QLowEnergyService::stateChanged, this, &BLESimpleDeviceService::stateChanged);
+    connect(service, &QLowEnergyService::characteristicChanged, this, &BLESimpleDeviceService::characteristicChanged);
+    connect(service, &QLowEnergyService::characteristicRead, this, &BLESimpleDeviceService::characteristicRead);
+    connect(service, &QLowEnergyService::characteristicWritten, this, &BLESimpleDeviceService::characteristicWritten);
+    connect(service, &QLowEnergyService::descriptorWritten, this, &BLESimpleDeviceService::descriptorWritten);
+    connect(service, static_cast<void (QLowEnergyService::*)(QLowEnergyService::ServiceError)>(&QLowEnergyService::error),
+            this, &BLESimpleDeviceService::error);
+}
+
+QBluetoothUuid QtBLESimpleDeviceService::serviceUuid() const
+{
+    return service->serviceUuid();
+}
+
+QLowEnergyCharacteristic QtBLESimpleDeviceService::characteristic(const QBluetoothUuid &uuid) const
+{
+    return service->characteristic(uuid);
+}
+
+void QtBLESimpleDeviceService::discoverDetails()
+{
+    service->discoverDetails();
+}
+
+void QtBLESimpleDeviceService::readCharacteristic(const QLowEnergyCharacteristic &characteristic)
+{
+    service->readCharacteristic(characteristic);
+}
+
+void QtBLESimpleDeviceService::writeCharacteristic(const QLowEnergyCharacteristic &characteristic, const QByteArray &value, QLowEnergyService::WriteMode mode)
+{
+    service->writeCharacteristic(characteristic, value, mode);
+}
+
+void QtBLESimpleDeviceService::writeDescriptor(const QLowEnergyDescriptor &descriptor, const QByteArray &value)
+{
+    service->writeDescriptor(descriptor, value);
+}
+
+QtBLESimpleDeviceTransport::QtBLESimpleDeviceTransport(const QBluetoothDeviceInfo &deviceInfo, QObject *parent)
+    : BLESimpleDeviceTransport(parent)
+    , controller(QLowEnergyController::createCentral(deviceInfo, this))
+{
+    connect(controller, &QLowEnergyController::connected, this, &BLESimpleDeviceTransport::connected);
+    connect(controller, &QLowEnergyController::disconnected, this, &BLESimpleDeviceTransport::disconnected);
+    connect(controller, &QLowEnergyController::serviceDiscovered, this, &BLESimpleDeviceTransport::serviceDiscovered);
+    connect(controller, &QLowEnergyController::discoveryFinished, this, &BLESimpleDeviceTransport::discoveryFinished);
+    connect(controller, static_cast<void (QLowEnergyController::*)(QLowEnergyController::Error)>(&QLowEnergyController::error),
+            this, &BLESimpleDeviceTransport::error);
+    connect(controller, &QLowEnergyController::connectionUpdated, this, &BLESimpleDeviceTransport::connectionUpdated);
+}
+
+void QtBLESimpleDeviceTransport::connectToDevice()
+{
+    controller->connectToDevice();
+}
+
+void QtBLESimpleDeviceTransport::disconnectFromDevice()
+{
+    controller->disconnectFromDevice();
+}
+
+void QtBLESimpleDeviceTransport::discoverServices()
+{
+    controller->discoverServices();
+}
+
+BLESimpleDeviceService* QtBLESimpleDeviceTransport::createServiceObject(const QBluetoothUuid &serviceUuid, QObject *parent)
+{
+    QLowEnergyService* service = controller->createServiceObject(serviceUuid);
+    if (!service)
+    {
+        return nullptr;
+    }
+
+    return new QtBLESimpleDeviceService(service, parent);
+}
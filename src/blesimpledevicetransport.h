@@ -0,0 +1,88 @@
+#ifndef BLESIMPLEDEVICETRANSPORT_H
+#define BLESIMPLEDEVICETRANSPORT_H
+
+#include <QObject>
+#include <QBluetoothDeviceInfo>
+#include <QLowEnergyController>
+#include <QLowEnergyService>
+#include <QLowEnergyConnectionParameters>
+
+// The part of QLowEnergyService used by BLESimpleDevice, so that a test can replace the Bluetooth stack
+class BLESimpleDeviceService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BLESimpleDeviceService(QObject *parent = nullptr) : QObject(parent) { }
+
+    virtual QBluetoothUuid serviceUuid() const = 0;
+    virtual QLowEnergyCharacteristic characteristic(const QBluetoothUuid& uuid) const = 0;
+
+    virtual void discoverDetails() = 0;
+    virtual void readCharacteristic(const QLowEnergyCharacteristic& characteristic) = 0;
+    virtual void writeCharacteristic(const QLowEnergyCharacteristic& characteristic, const QByteArray& value, QLowEnergyService::WriteMode mode) = 0;
+    virtual void writeDescriptor(const QLowEnergyDescriptor& descriptor, const QByteArray& value) = 0;
+
+signals:
+    void stateChanged(QLowEnergyService::ServiceState newState);
+    void characteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &newValue);
+    void characteristicRead(const QLowEnergyCharacteristic &characteristic, const QByteArray &value);
+    void characteristicWritten(const QLowEnergyCharacteristic &characteristic, const QByteArray &newValue);
+    void descriptorWritten(const QLowEnergyDescriptor &descriptor, const QByteArray &newValue);
+    void error(QLowEnergyService::ServiceError error);
+};
+
+// The part of QLowEnergyController used by BLESimpleDevice
+class BLESimpleDeviceTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BLESimpleDeviceTransport(QObject *parent = nullptr) : QObject(parent) { }
+
+    virtual void connectToDevice() = 0;
+    virtual void disconnectFromDevice() = 0;
+    virtual void discoverServices() = 0;
+    virtual BLESimpleDeviceService* createServiceObject(const QBluetoothUuid& serviceUuid, QObject *parent) = 0;
+
+signals:
+    void connected();
+    void disconnected();
+    void serviceDiscovered(const QBluetoothUuid &newService);
+    void discoveryFinished();
+    void error(QLowEnergyController::Error newError);
+    void connectionUpdated(const QLowEnergyConnectionParameters &parameters);
+};
+
+class QtBLESimpleDeviceService : public BLESimpleDeviceService
+{
+    Q_OBJECT
+public:
+    QtBLESimpleDeviceService(QLowEnergyService* service, QObject *parent);
+
+    QBluetoothUuid serviceUuid() const override;
+    QLowEnergyCharacteristic characteristic(const QBluetoothUuid& uuid) const override;
+
+    void discoverDetails() override;
+    void readCharacteristic(const QLowEnergyCharacteristic& characteristic) override;
+    void writeCharacteristic(const QLowEnergyCharacteristic& characteristic, const QByteArray& value, QLowEnergyService::WriteMode mode) override;
+    void writeDescriptor(const QLowEnergyDescriptor& descriptor, const QByteArray& value) override;
+
+private:
+    QLowEnergyService* service = nullptr;
+};
+
+class QtBLESimpleDeviceTransport : public BLESimpleDeviceTransport
+{
+    Q_OBJECT
+public:
+    QtBLESimpleDeviceTransport(const QBluetoothDeviceInfo& deviceInfo, QObject *parent);
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    void discoverServices() override;
+    BLESimpleDeviceService* createServiceObject(const QBluetoothUuid& serviceUuid, QObject *parent) override;
+
+private:
+    QLowEnergyController* controller = nullptr;
+};
+
+#endif // BLESIMPLEDEVICETRANSPORT_H
@@ -0,0 +1,112 @@
+#ifndef FAKEBLETRANSPORT_H
+#define FAKEBLETRANSPORT_H
+
+#include "blesimpledevice.h"
+
+// In-process replacement of the Bluetooth stack, the test emits the transport signals itself
+
+class FakeBLEService : public BLESimpleDeviceService
+{
+    Q_OBJECT
+public:
+    FakeBLEService(const QBluetoothUuid& uuid_, QObject *parent)
+        : BLESimpleDeviceService(parent)
+        , uuid(uuid_)
+    {
+        ++LiveCount();
+    }
+
+    ~FakeBLEService() override
+    {
+        --LiveCount();
+    }
+
+    static int& LiveCount()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    int ConnectedReceivers() const
+    {
+        return receivers(SIGNAL(stateChanged(QLowEnergyService::ServiceState))) +
+                receivers(SIGNAL(characteristicChanged(QLowEnergyCharacteristic,QByteArray))) +
+                receivers(SIGNAL(characteristicRead(QLowEnergyCharacteristic,QByteArray))) +
+                receivers(SIGNAL(characteristicWritten(QLowEnergyCharacteristic,QByteArray))) +
+                receivers(SIGNAL(descriptorWritten(QLowEnergyDescriptor,QByteArray))) +
+                receivers(SIGNAL(error(QLowEnergyService::ServiceError)));
+    }
+
+    QBluetoothUuid serviceUuid() const override { return uuid; }
+    QLowEnergyCharacteristic characteristic(const QBluetoothUuid&) const override { return QLowEnergyCharacteristic(); }
+
+    void discoverDetails() override { }
+    void readCharacteristic(const QLowEnergyCharacteristic&) override { }
+    void writeCharacteristic(const QLowEnergyCharacteristic&, const QByteArray&, QLowEnergyService::WriteMode) override { }
+    void writeDescriptor(const QLowEnergyDescriptor&, const QByteArray&) override { }
+
+private:
+    const QBluetoothUuid uuid;
+};
+
+class FakeBLETransport : public BLESimpleDeviceTransport
+{
+    Q_OBJECT
+public:
+    explicit FakeBLETransport(QObject *parent) : BLESimpleDeviceTransport(parent) { }
+
+    int ConnectedReceivers() const
+    {
+        return receivers(SIGNAL(connected())) +
+                receivers(SIGNAL(disconnected())) +
+                receivers(SIGNAL(serviceDiscovered(QBluetoothUuid))) +
+                receivers(SIGNAL(discoveryFinished())) +
+                receivers(SIGNAL(error(QLowEnergyController::Error))) +
+                receivers(SIGNAL(connectionUpdated(QLowEnergyConnectionParameters)));
+    }
+
+    void connectToDevice() override { }
+    void disconnectFromDevice() override { }
+    void discoverServices() override { }
+
+    BLESimpleDeviceService* createServiceObject(const QBluetoothUuid& serviceUuid, QObject *parent) override
+    {
+        return new FakeBLEService(serviceUuid, parent);
+    }
+};
+
+class FakeBLESimpleDevice : public BLESimpleDevice
+{
+    Q_OBJECT
+public:
+    FakeBLESimpleDevice(const QBluetoothAddress& address, const TargetMeasurementData& targetMeasurementData)
+        : BLESimpleDevice(address, targetMeasurementData)
+        , deviceAddress(address)
+    {
+    }
+
+    // the scan found the target device
+    void Discover()
+    {
+        QBluetoothDeviceInfo deviceInfo(deviceAddress, "fake", 0);
+        deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+        QMetaObject::invokeMethod(this, "OnDeviceDiscovered", Qt::DirectConnection, Q_ARG(QBluetoothDeviceInfo, deviceInfo));
+    }
+
+    FakeBLETransport* transport = nullptr;
+
+protected:
+    BLESimpleDeviceTransport* CreateTransport(const QBluetoothDeviceInfo&) override
+    {
+        transport = new FakeBLETransport(this);
+        return transport;
+    }
+
+    void PowerOnLocalDevice() override { }
+    void StartScan() override { }
+
+private:
+    const QBluetoothAddress deviceAddress;
+};
+
+#endif // FAKEBLETRANSPORT_H
@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    tst_blepollscheduler \
+    tst_blesimpledevice \
+    tst_blesimpledeviceapi
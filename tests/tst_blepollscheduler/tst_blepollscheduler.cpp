@@ -0,0 +1,173 @@
+#include <QtTest>
+#include "blepollscheduler.h"
+
+namespace
+{
+
+const QBluetoothUuid UuidA((quint16)0x2101);
+const QBluetoothUuid UuidB((quint16)0x2102);
+
+}
+
+class TestBLEPollScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void scalesStayWithinBudget_data();
+    void scalesStayWithinBudget();
+    void roundTripSmoothing();
+    void timedOutReadKeepsSlot();
+    void lostReadIsAbandoned();
+    void failuresBackOff();
+    void hotChannelIsReadFirst();
+    void setHotReschedulesImmediately();
+};
+
+void TestBLEPollScheduler::scalesStayWithinBudget_data()
+{
+    QTest::addColumn<double>("roundTrip");
+    QTest::addColumn<double>("hotDemand");
+    QTest::addColumn<double>("coldDemand");
+
+    QTest::newRow("fits") << 10.0 << 0.01 << 0.01;
+    QTest::newRow("only cold over budget") << 100.0 << 0.0 << 0.1;
+    QTest::newRow("only hot over budget") << 100.0 << 0.1 << 0.0;
+    QTest::newRow("hot takes everything") << 100.0 << 0.1 << 0.1;
+    QTest::newRow("cold squeezed") << 50.0 << 0.018 << 0.05;
+}
+
+void TestBLEPollScheduler::scalesStayWithinBudget()
+{
+    QFETCH(double, roundTrip);
+    QFETCH(double, hotDemand);
+    QFETCH(double, coldDemand);
+
+    const BLEPollScheduler::Scales scales = BLEPollScheduler::CalculateScales(roundTrip, hotDemand, coldDemand);
+    QVERIFY(scales.hot >= 1);
+    QVERIFY(scales.cold >= 1);
+
+    // half of the link, MaxPendingReads requests per round trip
+    const double budget = 0.5 * BLEPollScheduler::MaxPendingReads / roundTrip;
+    const double used = hotDemand / scales.hot + coldDemand / scales.cold;
+    QVERIFY(used <= budget * 1.000001 || (scales.hot == 1 && scales.cold == 1));
+
+    if (coldDemand > 0 && used > budget * 0.99)
+    {
+        // cold channels are never starved completely
+        QVERIFY(coldDemand / scales.cold >= budget * 0.1 * 0.999999);
+    }
+}
+
+void TestBLEPollScheduler::roundTripSmoothing()
+{
+    BLEPollScheduler scheduler;
+    QCOMPARE(BLEPollScheduler::CalculateScales(0, 1, 1).hot, 1.0);
+
+    scheduler.Add(UuidA, 100, false, 0);
+    QCOMPARE(scheduler.TakeNextRead(0), UuidA);
+    scheduler.FinishRead(UuidA, true, 40);
+    QCOMPARE(scheduler.AverageRoundTrip(), 40.0);
+    QCOMPARE(scheduler.NextReadTime(UuidA), qint64(100));
+
+    QCOMPARE(scheduler.TakeNextRead(99), QBluetoothUuid());
+    QCOMPARE(scheduler.TakeNextRead(100), UuidA);
+    scheduler.FinishRead(UuidA, true, 120);
+    QCOMPARE(scheduler.AverageRoundTrip(), 37.5);
+}
+
+void TestBLEPollScheduler::timedOutReadKeepsSlot()
+{
+    BLEPollScheduler scheduler;
+    scheduler.Add(UuidA, 10, false, 0);
+    scheduler.Add(UuidB, 10, false, 0);
+
+    QVERIFY(!scheduler.TakeNextRead(0).isNull());
+    QVERIFY(!scheduler.TakeNextRead(0).isNull());
+    QCOMPARE(scheduler.PendingReads(), BLEPollScheduler::MaxPendingReads);
+
+    scheduler.CheckTimeouts(BLEPollScheduler::ReadTimeout + 1);
+    QCOMPARE(scheduler.PendingReads(), BLEPollScheduler::MaxPendingReads);
+    QCOMPARE(scheduler.TakeNextRead(BLEPollScheduler::ReadTimeout + 1), QBluetoothUuid());
+    QCOMPARE(scheduler.NextDeadline(), qint64(BLEPollScheduler::ReadAbandonTimeout + 1));
+
+    // the late answer frees the slot, but isn't a round trip sample
+    scheduler.FinishRead(UuidA, true, BLEPollScheduler::ReadTimeout + 500);
+    QCOMPARE(scheduler.PendingReads(), 1);
+    QCOMPARE(scheduler.AverageRoundTrip(), 0.0);
+}
+
+void TestBLEPollScheduler::lostReadIsAbandoned()
+{
+    BLEPollScheduler scheduler;
+    scheduler.Add(UuidA, 10, false, 0);
+    QCOMPARE(scheduler.TakeNextRead(0), UuidA);
+
+    scheduler.CheckTimeouts(BLEPollScheduler::ReadTimeout + 1);
+    QVERIFY(scheduler.IsPending(UuidA));
+
+    scheduler.CheckTimeouts(BLEPollScheduler::ReadAbandonTimeout + 1);
+    QVERIFY(!scheduler.IsPending(UuidA));
+    QCOMPARE(scheduler.PendingReads(), 0);
+}
+
+void TestBLEPollScheduler::failuresBackOff()
+{
+    BLEPollScheduler scheduler;
+    scheduler.Add(UuidA, 100, false, 0);
+
+    QCOMPARE(scheduler.TakeNextRead(0), UuidA);
+    scheduler.FinishRead(UuidA, false, 5);
+    QCOMPARE(scheduler.NextReadTime(UuidA), qint64(200));
+
+    QCOMPARE(scheduler.TakeNextRead(200), UuidA);
+    scheduler.FinishRead(UuidA, false, 205);
+    QCOMPARE(scheduler.NextReadTime(UuidA), qint64(600));
+
+    // capped
+    qint64 now = 600;
+    for (int i = 0; i < 20; ++i)
+    {
+        QCOMPARE(scheduler.TakeNextRead(now), UuidA);
+        scheduler.FinishRead(UuidA, false, now + 5);
+        QVERIFY(scheduler.NextReadTime(UuidA) - now <= BLEPollScheduler::MaxBackoffInterval);
+        now = scheduler.NextReadTime(UuidA);
+    }
+
+    // a success resets the backoff
+    QCOMPARE(scheduler.TakeNextRead(now), UuidA);
+    scheduler.FinishRead(UuidA, true, now + 10);
+    QCOMPARE(scheduler.NextReadTime(UuidA), now + 100);
+}
+
+void TestBLEPollScheduler::hotChannelIsReadFirst()
+{
+    BLEPollScheduler scheduler;
+    scheduler.Add(UuidA, 10, false, 0);
+    scheduler.Add(UuidB, 10, true, 5);
+
+    QCOMPARE(scheduler.TakeNextRead(5), UuidB);
+    QCOMPARE(scheduler.TakeNextRead(5), UuidA);
+    QCOMPARE(scheduler.TakeNextRead(5), QBluetoothUuid());
+}
+
+void TestBLEPollScheduler::setHotReschedulesImmediately()
+{
+    BLEPollScheduler scheduler;
+    scheduler.Add(UuidA, 10, false, 0);
+    scheduler.Add(UuidB, 10, false, 1);
+
+    // a 100 ms round trip can't carry two channels at 10 ms, both are slowed down
+    QCOMPARE(scheduler.TakeNextRead(1), UuidA);
+    scheduler.FinishRead(UuidA, true, 100);
+    const qint64 coldNextRead = scheduler.NextReadTime(UuidA);
+    QVERIFY(coldNextRead > 10);
+
+    scheduler.SetHot(UuidA, true);
+    QVERIFY(scheduler.NextReadTime(UuidA) < coldNextRead);
+    QVERIFY(scheduler.CurrentScales().hot < scheduler.CurrentScales().cold);
+}
+
+QTEST_GUILESS_MAIN(TestBLEPollScheduler)
+
+#include "tst_blepollscheduler.moc"
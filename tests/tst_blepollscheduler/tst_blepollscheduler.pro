@@ -0,0 +1,17 @@
+QT       += core bluetooth testlib
+QT       -= gui
+
+TEMPLATE = app
+TARGET = tst_blepollscheduler
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    ../../src/blepollscheduler.cpp \
+    tst_blepollscheduler.cpp
+
+HEADERS += \
+    ../../src/blepollscheduler.h
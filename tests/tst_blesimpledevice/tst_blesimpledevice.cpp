@@ -0,0 +1,140 @@
+#include <QtTest>
+#include "fakebletransport.h"
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const static int ReconnectCycles = 5000;
+const static int WarmUpCycles = 10;
+const static qint64 MaxResidentGrowth = 4 * 1024 * 1024;
+
+const QBluetoothAddress TargetAddress("00:00:00:00:00:01");
+const QBluetoothUuid ServiceUuid((quint16)0x1101);
+const QBluetoothUuid CharacteristicUuid((quint16)0x2101);
+
+qint64 ResidentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/statm");
+    if (file.open(QIODevice::ReadOnly))
+    {
+        const QList<QByteArray> fields = file.readAll().split(' ');
+        if (fields.count() > 1)
+        {
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+
+    return -1;
+}
+
+BLESimpleDevice::TargetMeasurementData MakeTargetMeasurementData()
+{
+    BLESimpleDevice::TargetMeasurementData tmd;
+    tmd.servicesAndCharacteristics = { { ServiceUuid, { CharacteristicUuid } } };
+    tmd.characteristicNames.insert(CharacteristicUuid, "finger_1");
+    return tmd;
+}
+
+// connect, discover the target service twice, then drop the link
+void ConnectCycle(FakeBLESimpleDevice& device)
+{
+    device.Discover();
+    QVERIFY(device.transport);
+
+    emit device.transport->connected();
+    emit device.transport->serviceDiscovered(ServiceUuid);
+    emit device.transport->serviceDiscovered(ServiceUuid);
+    emit device.transport->discoveryFinished();
+
+    const QList<FakeBLEService*> services = device.findChildren<FakeBLEService*>();
+    QCOMPARE(services.count(), 1);
+    QCOMPARE(device.ServiceObjectCount(), 1);
+    emit services.first()->stateChanged(QLowEnergyService::ServiceDiscovered);
+
+    emit device.transport->disconnected();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+}
+
+class TestBLESimpleDevice : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reconnectCyclesKeepResourcesBounded();
+    void duplicateServiceDiscoveryEmitsDeviceChanged();
+};
+
+void TestBLESimpleDevice::reconnectCyclesKeepResourcesBounded()
+{
+    FakeBLESimpleDevice device(TargetAddress, MakeTargetMeasurementData());
+
+    // warm up, so that lazily allocated objects don't count as growth
+    for (int i = 0; i < WarmUpCycles; ++i)
+    {
+        ConnectCycle(device);
+        if (QTest::currentTestFailed())
+        {
+            return;
+        }
+    }
+
+    FakeBLETransport* transport = device.transport;
+    const int initialChildren = device.findChildren<QObject*>().count();
+    const int initialTransportReceivers = transport->ConnectedReceivers();
+    const qint64 initialResident = ResidentMemory();
+
+    for (int i = 0; i < ReconnectCycles; ++i)
+    {
+        ConnectCycle(device);
+        if (QTest::currentTestFailed())
+        {
+            return;
+        }
+
+        QCOMPARE(device.transport, transport);
+        QCOMPARE(device.ServiceObjectCount(), 0);
+        QCOMPARE(FakeBLEService::LiveCount(), 0);
+    }
+
+    QCOMPARE(device.findChildren<QObject*>().count(), initialChildren);
+    QCOMPARE(transport->ConnectedReceivers(), initialTransportReceivers);
+
+    if (initialResident >= 0)
+    {
+        QVERIFY2(ResidentMemory() - initialResident < MaxResidentGrowth, "resident memory grows with reconnects");
+    }
+}
+
+void TestBLESimpleDevice::duplicateServiceDiscoveryEmitsDeviceChanged()
+{
+    FakeBLESimpleDevice device(TargetAddress, MakeTargetMeasurementData());
+    device.Discover();
+    emit device.transport->connected();
+    emit device.transport->serviceDiscovered(ServiceUuid);
+
+    const QList<FakeBLEService*> services = device.findChildren<FakeBLEService*>();
+    QCOMPARE(services.count(), 1);
+    QVERIFY(services.first()->ConnectedReceivers() > 0);
+
+    QSignalSpy spy(&device, &BLESimpleDevice::DeviceChanged);
+    emit device.transport->serviceDiscovered(ServiceUuid);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(device.ServiceObjectCount(), 1);
+
+    emit device.transport->disconnected();
+    QCOMPARE(services.first()->ConnectedReceivers(), 0);
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QCOMPARE(FakeBLEService::LiveCount(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestBLESimpleDevice)
+
+#include "tst_blesimpledevice.moc"
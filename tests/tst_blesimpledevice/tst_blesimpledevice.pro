@@ -0,0 +1,22 @@
+QT       += core bluetooth testlib
+QT       -= gui
+
+TEMPLATE = app
+TARGET = tst_blesimpledevice
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src ../shared
+
+SOURCES += \
+    ../../src/blepollscheduler.cpp \
+    ../../src/blesimpledevice.cpp \
+    ../../src/blesimpledevicetransport.cpp \
+    tst_blesimpledevice.cpp
+
+HEADERS += \
+    ../../src/blepollscheduler.h \
+    ../../src/blesimpledevice.h \
+    ../../src/blesimpledevicetransport.h \
+    ../shared/fakebletransport.h
@@ -0,0 +1,227 @@
+#include <QtTest>
+#include "blesimpledeviceapi_p.h"
+#include "fakebletransport.h"
+#include <cstring>
+#include <cstddef>
+
+namespace
+{
+
+const static int SampleBufferCapacity = 4;
+
+const BLESDChannelConfig Channels[] = {
+    { "1101", "2101", "finger_1", 0 },
+    { "{00001102-0000-1000-8000-00805f9b34fb}", "2102", "finger_2", 50 }
+};
+
+BLESDDeviceConfig MakeConfig()
+{
+    BLESDDeviceConfig config;
+    std::memset(&config, 0, sizeof(config));
+    config.structSize = sizeof(BLESDDeviceConfig);
+    config.channelStructSize = sizeof(BLESDChannelConfig);
+    config.address = "30:7B:F5:33:2B:9D";
+    config.channels = Channels;
+    config.channelCount = 2;
+    config.sampleBufferCapacity = SampleBufferCapacity;
+    return config;
+}
+
+BLESDDevice* CreateFakeDevice(const BLESDDeviceConfig& config)
+{
+    return blesd_create_with_factory(&config, [](const QBluetoothAddress& address, const BLESimpleDevice::TargetMeasurementData& tmd) {
+        return new FakeBLESimpleDevice(address, tmd);
+    });
+}
+
+void EmitValue(BLESDDevice* handle, const QString& name, char value)
+{
+    emit handle->device->MeasuredValueChanged(name, QByteArray(1, value));
+}
+
+}
+
+class TestBLESimpleDeviceApi : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ringBufferWrapsAndOverflows();
+    void longValueIsTruncated();
+    void measuredDataClearedClearsValidFlag();
+    void destroyFromCallback();
+    void createRejectsBadConfigs();
+};
+
+void TestBLESimpleDeviceApi::ringBufferWrapsAndOverflows()
+{
+    BLESDDevice* handle = CreateFakeDevice(MakeConfig());
+    QVERIFY(handle);
+
+    BLESDSample samples[SampleBufferCapacity * 2];
+
+    EmitValue(handle, "finger_1", 0);
+    EmitValue(handle, "finger_2", 1);
+    EmitValue(handle, "finger_1", 2);
+    QCOMPARE(blesd_drain_samples(handle, samples, 2), 2);
+    QCOMPARE(int(samples[0].data[0]), 0);
+    QCOMPARE(int(samples[1].data[0]), 1);
+    QCOMPARE(samples[1].channel, 1);
+
+    // the write position wraps, then the oldest sample is overwritten
+    for (char value = 3; value <= 6; ++value)
+    {
+        EmitValue(handle, "finger_1", value);
+    }
+
+    QCOMPARE(blesd_dropped_samples(handle), int64_t(1));
+    QCOMPARE(blesd_drain_samples(handle, samples, SampleBufferCapacity * 2), SampleBufferCapacity);
+    for (int i = 0; i < SampleBufferCapacity; ++i)
+    {
+        QCOMPARE(int(samples[i].data[0]), i + 3);
+        QCOMPARE(samples[i].flags, int32_t(BLESD_SAMPLE_VALID));
+        QCOMPARE(samples[i].size, 1);
+    }
+
+    QVERIFY(samples[0].timestampUs <= samples[SampleBufferCapacity - 1].timestampUs);
+    QCOMPARE(blesd_drain_samples(handle, samples, SampleBufferCapacity * 2), 0);
+
+    // unknown names aren't buffered
+    emit handle->device->MeasuredValueChanged("unknown", QByteArray(1, 7));
+    QCOMPARE(blesd_drain_samples(handle, samples, SampleBufferCapacity * 2), 0);
+
+    blesd_destroy(handle);
+}
+
+void TestBLESimpleDeviceApi::longValueIsTruncated()
+{
+    BLESDDevice* handle = CreateFakeDevice(MakeConfig());
+    QVERIFY(handle);
+
+    emit handle->device->MeasuredValueChanged("finger_2", QByteArray(BLESD_MAX_VALUE_SIZE + 8, 'x'));
+
+    BLESDSample sample;
+    QCOMPARE(blesd_drain_samples(handle, &sample, 1), 1);
+    QCOMPARE(sample.size, BLESD_MAX_VALUE_SIZE);
+    QCOMPARE(sample.flags, int32_t(BLESD_SAMPLE_VALID | BLESD_SAMPLE_TRUNCATED));
+
+    blesd_destroy(handle);
+}
+
+void TestBLESimpleDeviceApi::measuredDataClearedClearsValidFlag()
+{
+    BLESDDevice* handle = CreateFakeDevice(MakeConfig());
+    QVERIFY(handle);
+
+    BLESDSample values[2];
+    QCOMPARE(blesd_read_values(handle, values, 2), 2);
+    QCOMPARE(values[0].flags, 0);
+
+    EmitValue(handle, "finger_1", 42);
+    QCOMPARE(blesd_read_values(handle, values, 2), 2);
+    QCOMPARE(values[0].flags, int32_t(BLESD_SAMPLE_VALID));
+    QCOMPARE(int(values[0].data[0]), 42);
+    QCOMPARE(values[1].flags, 0);
+
+    emit handle->device->MeasuredDataCleared();
+    QCOMPARE(blesd_read_values(handle, values, 2), 2);
+    QCOMPARE(values[0].flags, 0);
+    QCOMPARE(values[0].channel, 0);
+
+    blesd_destroy(handle);
+}
+
+void TestBLESimpleDeviceApi::destroyFromCallback()
+{
+    BLESDDevice* handle = CreateFakeDevice(MakeConfig());
+    QVERIFY(handle);
+
+    QPointer<BLESimpleDevice> device(handle->device);
+    int calls = 0;
+
+    blesd_set_callback(handle, [](BLESDDevice* callbackHandle, int32_t event, void* userData) {
+        ++*static_cast<int*>(userData);
+        if (event == BLESD_EVENT_SAMPLES_AVAILABLE)
+        {
+            blesd_destroy(callbackHandle);
+        }
+    }, &calls);
+
+    // the handle is gone after this emit, the device object only after the deferred delete
+    emit device->MeasuredValueChanged("finger_1", QByteArray(1, 1));
+    QCOMPARE(calls, 1);
+    QVERIFY(device);
+
+    // disconnected from the freed handle
+    emit device->MeasuredValueChanged("finger_1", QByteArray(1, 2));
+    emit device->DeviceChanged();
+    QCOMPARE(calls, 1);
+
+    blesd_process_events(0);
+    QVERIFY(device.isNull());
+}
+
+void TestBLESimpleDeviceApi::createRejectsBadConfigs()
+{
+    QCOMPARE(blesd_create(nullptr), static_cast<BLESDDevice*>(nullptr));
+
+    const auto rejected = [](const BLESDDeviceConfig& config) {
+        return blesd_create(&config) == nullptr;
+    };
+
+    BLESDDeviceConfig config = MakeConfig();
+    config.structSize = int32_t(offsetof(BLESDDeviceConfig, channelCount));
+    QVERIFY(rejected(config));
+
+    config = MakeConfig();
+    config.channelStructSize = int32_t(offsetof(BLESDChannelConfig, pollIntervalMs));
+    QVERIFY(rejected(config));
+
+    config = MakeConfig();
+    config.address = nullptr;
+    QVERIFY(rejected(config));
+
+    config = MakeConfig();
+    config.address = "not an address";
+    QVERIFY(rejected(config));
+
+    config = MakeConfig();
+    config.channelCount = -1;
+    QVERIFY(rejected(config));
+
+    config = MakeConfig();
+    config.channels = nullptr;
+    QVERIFY(rejected(config));
+
+    const BLESDChannelConfig badServiceUuid[] = { { "xyz", "2101", "finger_1", 0 } };
+    const BLESDChannelConfig badCharacteristicUuid[] = { { "1101", "{00002101-0000}", "finger_1", 0 } };
+    const BLESDChannelConfig emptyName[] = { { "1101", "2101", "", 0 } };
+    const BLESDChannelConfig duplicateName[] = { { "1101", "2101", "finger_1", 0 }, { "1101", "2102", "finger_1", 0 } };
+    const BLESDChannelConfig duplicateUuid[] = { { "1101", "2101", "finger_1", 0 }, { "1102", "2101", "finger_2", 0 } };
+
+    for (const BLESDChannelConfig* channels : { badServiceUuid, badCharacteristicUuid, emptyName })
+    {
+        config = MakeConfig();
+        config.channels = channels;
+        config.channelCount = 1;
+        QVERIFY(rejected(config));
+    }
+
+    for (const BLESDChannelConfig* channels : { duplicateName, duplicateUuid })
+    {
+        config = MakeConfig();
+        config.channels = channels;
+        config.channelCount = 2;
+        QVERIFY(rejected(config));
+    }
+
+    config = MakeConfig();
+    BLESDDevice* handle = CreateFakeDevice(config);
+    QVERIFY(handle);
+    QCOMPARE(blesd_channel_count(handle), 2);
+    blesd_destroy(handle);
+}
+
+QTEST_GUILESS_MAIN(TestBLESimpleDeviceApi)
+
+#include "tst_blesimpledeviceapi.moc"
@@ -0,0 +1,28 @@
+QT       += core bluetooth testlib
+QT       -= gui
+
+TEMPLATE = app
+TARGET = tst_blesimpledeviceapi
+
+CONFIG += c++11 testcase console
+CONFIG -= app_bundle
+
+# the API is compiled into the test, not imported from the library
+DEFINES += BLESIMPLEDEVICE_LIBRARY
+
+INCLUDEPATH += ../../src ../shared
+
+SOURCES += \
+    ../../src/blepollscheduler.cpp \
+    ../../src/blesimpledevice.cpp \
+    ../../src/blesimpledevicetransport.cpp \
+    ../../src/blesimpledeviceapi.cpp \
+    tst_blesimpledeviceapi.cpp
+
+HEADERS += \
+    ../../src/blepollscheduler.h \
+    ../../src/blesimpledevice.h \
+    ../../src/blesimpledevicetransport.h \
+    ../../src/blesimpledeviceapi.h \
+    ../../src/blesimpledeviceapi_p.h \
+    ../shared/fakebletransport.h